@@ -0,0 +1,110 @@
+#ifndef PRICE_HISTORY_H
+#define PRICE_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Historico de precos append-only, mapeado em memoria (mmap).
+//
+// Formato do arquivo:
+//   [cabecalho 32 bytes] [registro] [registro] ...
+// Registro de produto:    0x01, len (varint), url (len bytes)
+// Registro de observacao: 0x02, id do produto (varint),
+//                         distancia ate a observacao anterior do mesmo produto (varint, 0 = primeira),
+//                         delta do timestamp (zigzag varint), delta do preco em centavos (zigzag varint)
+//
+// Os deltas sao relativos a observacao anterior do mesmo produto, entao cada
+// produto forma uma serie encadeada de tras para frente dentro do log.
+// A serie de cada produto deve ser gravada em ordem de tempo: record() rejeita
+// timestamps anteriores a ultima observacao do produto.
+// O indice em memoria (url -> estatisticas e ultimo offset) e salvo em
+// "<arquivo>.idx" junto com o offset do log que ele cobre; ao abrir, o
+// checkpoint e carregado e apenas os registros posteriores sao relidos.
+// Sem checkpoint valido, o log inteiro e lido sequencialmente.
+// O arquivo fica travado (flock) enquanto aberto, entao ha um unico processo
+// escritor; a instancia em si nao e thread-safe.
+class PriceHistory {
+public:
+    struct Observation {
+        int64_t timestamp;
+        int64_t price_cents;
+    };
+
+    struct ProductStats {
+        std::string url;
+        int64_t min_price = 0;
+        int64_t max_price = 0;
+        int64_t last_price = 0;
+        int64_t last_timestamp = 0;
+        uint64_t count = 0;
+    };
+
+    struct PriceDrop {
+        std::string url;
+        int64_t from_price;
+        int64_t to_price;
+        double percent;
+    };
+
+    PriceHistory();
+    ~PriceHistory();
+    PriceHistory(const PriceHistory&) = delete;
+    PriceHistory& operator=(const PriceHistory&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return data_ != nullptr; }
+    bool sync();
+    // Grava o indice em "<arquivo>.idx"; tambem chamado por close()
+    bool checkpoint();
+
+    // A url e canonizada antes de ser usada como chave; falha se timestamp for
+    // anterior a ultima observacao do produto
+    bool record(const std::string& url, int64_t timestamp, int64_t price_cents);
+
+    bool get_stats(const std::string& url, ProductStats& out) const;
+    std::vector<Observation> get_series(const std::string& url) const;
+    // Produtos cujo ultimo preco caiu pelo menos min_percent em relacao ao
+    // maior preco vigente na janela [now - window_seconds, now], incluindo o
+    // preco em vigor no inicio da janela (ultima observacao ate esse instante)
+    std::vector<PriceDrop> find_drops(double min_percent, int64_t window_seconds, int64_t now) const;
+
+    size_t product_count() const { return products_.size(); }
+    const std::string& last_error() const { return last_error_; }
+
+    static std::string canonical_url(const std::string& url);
+    static bool parse_price_cents(const std::string& price, int64_t& cents);
+
+private:
+    struct ProductIndex {
+        ProductStats stats;
+        uint64_t last_offset = 0;
+    };
+
+    int fd_;
+    uint8_t* data_;
+    uint64_t capacity_;
+    uint64_t used_;
+    long owner_pid_; // processo que abriu o arquivo; filhos de fork nao podem gravar
+    bool indexed_;
+    uint64_t checkpoint_offset_; // parte do log coberta pelo ultimo checkpoint
+    std::string path_;
+    std::string last_error_;
+    std::vector<ProductIndex> products_;
+    std::unordered_map<std::string, uint32_t> ids_;
+
+    bool map_file(uint64_t capacity);
+    bool ensure_capacity(uint64_t extra);
+    bool load_checkpoint();
+    bool rebuild_index(uint64_t start);
+    void set_used(uint64_t used);
+    uint32_t add_product(const std::string& url);
+
+    template <typename Visitor>
+    void walk_back(const ProductIndex& product, Visitor&& visit) const;
+};
+
+#endif // PRICE_HISTORY_H
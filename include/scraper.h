@@ -9,6 +9,8 @@
 
 #include "logger.h"
 #include "config.h"
+#include "price_history.h"
+#include "shard.h"
 
 class WebScraper {
 
@@ -17,12 +19,15 @@ public:
     ~WebScraper();
     bool scrape();
     bool scrape_um_site(const Config::SiteConfig& site, const std::string& searchTerm);
+    void set_price_history(PriceHistory* history);
+    bool scrape_shard(const ShardSpec& spec, const std::vector<std::string>& terms, const std::string& shard_dir);
 
 private:
     Config config;
     Logger& logger;
     CURL* curl;
     std::string output_directory_;
+    PriceHistory* price_history_ = nullptr;
 
     struct ScrapedItem {
         std::string title;
@@ -37,8 +42,11 @@ private:
     std::vector<ScrapedItem> parse_mercado_livre(GumboNode* node);
     std::vector<ScrapedItem> parse_olx(GumboNode* node);
     std::vector<ScrapedItem> parse_amazon(GumboNode* node);
+    std::string build_search_url(const Config::SiteConfig& site, const std::string& searchTerm);
+    std::vector<ScrapedItem> parse_page(const Config::SiteConfig& site, const std::string& html);
 
     void save_to_file(const std::vector<ScrapedItem>& items, const std::string& output);
+    void record_prices(const std::vector<ScrapedItem>& items);
 
     std::string trim(const std::string& str);
     void search_node(GumboNode* node, const std::string& tag, const std::string& attribute,
@@ -0,0 +1,97 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class PriceHistory;
+
+// Particionamento deterministico de termos de busca entre varios processos.
+// Cada worker recebe a lista completa de termos e o seu indice/quantidade de
+// shards; um termo pertence ao shard hash(termo) % count, entao dois workers
+// nunca buscam o mesmo termo, independente da ordem da lista ou da maquina.
+struct ShardSpec {
+    size_t index = 0;
+    size_t count = 1;
+};
+
+// Busca (site, termo) que nao pode ser baixada
+struct FailedFetch {
+    std::string site;
+    std::string term;
+};
+
+// Cabecalho de cada arquivo de shard: identifica o shard, a lista de termos
+// da execucao (fingerprint) e as buscas que falharam
+struct ShardHeader {
+    ShardSpec spec;
+    uint64_t terms_fingerprint = 0;
+    std::vector<FailedFetch> failed;
+};
+
+struct MergeResult {
+    size_t records = 0;
+    size_t history_skipped = 0; // linhas ja presentes (ou mais antigas) no historico
+    std::vector<FailedFetch> failed;
+};
+
+// Uma linha da saida estruturada (TSV) de um shard
+struct ShardRecord {
+    std::string site;
+    std::string term;
+    std::string title;
+    std::string price;
+    std::string url;
+    int64_t timestamp = 0; // momento da coleta (epoch, segundos)
+};
+
+namespace shard {
+
+// Minusculas e espacos colapsados, para "TV  4k" e "tv 4k" caírem no mesmo shard
+std::string normalize_term(const std::string& term);
+// FNV-1a 64 bits: estavel entre execucoes, compiladores e maquinas
+uint64_t stable_hash(const std::string& text);
+bool owns_term(const std::string& term, const ShardSpec& spec);
+
+bool parse_spec(const std::string& text, ShardSpec& spec); // formato "indice/quantidade"
+// Falha se o arquivo nao existir, nao puder ser lido ou nao tiver nenhum termo
+bool load_terms(const std::string& path, std::vector<std::string>& terms, std::string& error);
+// Termos deste shard, normalizados e sem duplicatas, na ordem original
+std::vector<std::string> select_terms(const std::vector<std::string>& terms, const ShardSpec& spec);
+// Hash da lista normalizada, sem duplicatas e ordenada: workers e merge da
+// mesma execucao devem chegar ao mesmo valor
+uint64_t terms_fingerprint(const std::vector<std::string>& terms);
+
+std::string shard_file_name(const ShardSpec& spec); // "shard-<indice>-of-<quantidade>.tsv"
+// Escreve em arquivo temporario e renomeia, para o merge nunca ler um shard pela metade
+bool write_shard(const std::string& output_dir, const ShardHeader& header, const std::vector<ShardRecord>& records);
+// Falha se o arquivo nao existir ou nao tiver cabecalho de shard valido
+bool read_shard(const std::string& path, ShardHeader& header, std::vector<ShardRecord>& records);
+
+// Junta os `count` shards de output_dir, remove duplicatas por (site, URL canonica)
+// e ordena por site, termo e titulo. Falha se algum shard estiver faltando, for
+// de outro particionamento ou de outra lista de termos. Buscas que falharam nos
+// workers sao listadas em result.failed e no cabecalho do arquivo final; nesse
+// caso o merge e gravado, mas retorna false.
+// Com history, as linhas ja deduplicadas sao gravadas nesse historico unico:
+// os workers nao gravam historico, entao produtos achados por termos de
+// shards diferentes continuam numa serie so. So merges sem buscas falhas
+// entram no historico, e linhas com coleta ate a ultima observacao do produto
+// sao ignoradas, entao repetir ou retomar um merge nao duplica observacoes.
+bool merge_shards(const std::string& output_dir, const std::vector<std::string>& terms, size_t count,
+                  const std::string& merged_path, MergeResult& result, std::string& error,
+                  PriceHistory* history = nullptr);
+
+// Dispara `count` processos filhos (fork), cada um executando worker com o seu
+// ShardSpec, e espera todos. Retorna true se todos terminaram com sucesso;
+// excecao no worker conta como falha. flush_output (ex.: esvaziar o Logger) e
+// chamado junto com o flush de stdio antes de cada fork e antes do filho sair.
+bool run_local_workers(size_t count, const std::function<bool(const ShardSpec&)>& worker,
+                       const std::function<void()>& flush_output = {});
+
+} // namespace shard
+
+#endif // SHARD_H
@@ -0,0 +1,662 @@
+#include "price_history.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <random>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'P', 'D', 'S', 'H', 'I', 'S', 'T', '1'};
+const uint64_t kHeaderSize = 32;
+const uint64_t kUsedOffset = 8;
+const uint64_t kFileIdOffset = 16; // identifica o log para validar o checkpoint
+const char kIndexMagic[8] = {'P', 'D', 'S', 'I', 'D', 'X', '0', '1'};
+const uint32_t kMaxUrlSize = 64 * 1024; // limite da chave, no record e no checkpoint
+const uint64_t kGrowStep = 1 << 20; // o arquivo cresce em blocos de 1MB
+const uint8_t kProductRecord = 0x01;
+const uint8_t kObservationRecord = 0x02;
+const size_t kMaxVarint = 10;
+
+size_t put_varint(uint8_t* p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = static_cast<uint8_t>(v) | 0x80;
+        v >>= 7;
+    }
+    p[n++] = static_cast<uint8_t>(v);
+    return n;
+}
+
+// Retorna o numero de bytes lidos, ou 0 se o varint estiver truncado/invalido
+size_t get_varint(const uint8_t* p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (size_t n = 0; n < kMaxVarint && p + n < end; ++n) {
+        v |= static_cast<uint64_t>(p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80)) return n + 1;
+    }
+    return 0;
+}
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+// Decodifica o corpo de uma observacao (tudo depois do byte de tipo)
+size_t get_observation(const uint8_t* p, const uint8_t* end, uint64_t& id,
+                       uint64_t& prev_distance, int64_t& dts, int64_t& dprice) {
+    const uint8_t* start = p;
+    uint64_t raw;
+    size_t n;
+    if (!(n = get_varint(p, end, id))) return 0;
+    p += n;
+    if (!(n = get_varint(p, end, prev_distance))) return 0;
+    p += n;
+    if (!(n = get_varint(p, end, raw))) return 0;
+    p += n;
+    dts = unzigzag(raw);
+    if (!(n = get_varint(p, end, raw))) return 0;
+    p += n;
+    dprice = unzigzag(raw);
+    return static_cast<size_t>(p - start);
+}
+
+// Separa "esquema://host" (em minusculas), caminho e query (sem o '?')
+void split_url(const std::string& url, std::string& origin, std::string& path, std::string& query) {
+    size_t scheme_end = url.find("://");
+    size_t host_start = scheme_end == std::string::npos ? 0 : scheme_end + 3;
+    size_t host_end = url.find_first_of("/?", host_start);
+    if (host_end == std::string::npos) host_end = url.size();
+    size_t query_start = url.find('?', host_end);
+
+    origin = url.substr(0, host_end);
+    std::transform(origin.begin(), origin.end(), origin.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    path = url.substr(host_end, query_start == std::string::npos ? std::string::npos : query_start - host_end);
+    query = query_start == std::string::npos ? "" : url.substr(query_start + 1);
+}
+
+std::string percent_decode(const std::string& text) {
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size() &&
+            std::isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+            result += static_cast<char>(std::stoi(text.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else if (text[i] == '+') {
+            result += ' ';
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+// Valor bruto (ainda codificado) de um parametro da query, ou vazio
+std::string query_param(const std::string& query, const std::string& name) {
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t amp = query.find('&', pos);
+        if (amp == std::string::npos) amp = query.size();
+        if (query.compare(pos, name.size() + 1, name + "=") == 0) {
+            return query.substr(pos + name.size() + 1, amp - pos - name.size() - 1);
+        }
+        pos = amp + 1;
+    }
+    return "";
+}
+
+// Le um id a partir de `pos`: caracteres alfanumericos ate o proximo separador
+std::string read_id(const std::string& path, size_t pos) {
+    size_t end = pos;
+    while (end < path.size() && std::isalnum(static_cast<unsigned char>(path[end]))) ++end;
+    return path.substr(pos, end - pos);
+}
+
+// URL canonica quando o caminho tem um id de produto conhecido; senao vazio
+std::string product_url(const std::string& origin, const std::string& path) {
+    for (const char* marker : {"/dp/", "/gp/product/"}) {
+        size_t pos = path.find(marker);
+        if (pos != std::string::npos) {
+            std::string asin = read_id(path, pos + std::strlen(marker));
+            if (!asin.empty()) return origin + "/dp/" + asin;
+        }
+    }
+
+    size_t pos = path.find("/p/MLB");
+    if (pos != std::string::npos) {
+        std::string id = read_id(path, pos + 6);
+        if (!id.empty()) return origin + "/p/MLB" + id;
+    }
+    pos = path.find("/MLB-");
+    if (pos != std::string::npos) {
+        std::string id = read_id(path, pos + 5);
+        if (!id.empty()) return origin + "/MLB-" + id;
+    }
+    return "";
+}
+
+// Hosts/caminhos de rastreamento de clique (anuncios patrocinados)
+bool is_redirect_url(const std::string& origin, const std::string& path) {
+    size_t scheme_end = origin.find("://");
+    std::string host = scheme_end == std::string::npos ? origin : origin.substr(scheme_end + 3);
+    return host.compare(0, 5, "click") == 0 ||
+           path.find("/sspa/click") != std::string::npos ||
+           path.find("/mclics/") != std::string::npos;
+}
+
+template <typename T>
+void write_pod(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool read_pod(std::ifstream& file, T& value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+} // namespace
+
+PriceHistory::PriceHistory()
+    : fd_(-1), data_(nullptr), capacity_(0), used_(0), owner_pid_(0),
+      indexed_(false), checkpoint_offset_(0) {}
+
+PriceHistory::~PriceHistory() {
+    close();
+}
+
+bool PriceHistory::open(const std::string& path) {
+    close();
+    path_ = path;
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        last_error_ = "Falha ao abrir historico " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // Um unico escritor por arquivo: cada processo manteria o seu proprio
+    // used_ e sobrescreveria os registros do outro
+    if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+        last_error_ = errno == EWOULDBLOCK
+                          ? "Historico " + path + " ja esta aberto por outro escritor"
+                          : "Falha ao travar historico " + path + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+    owner_pid_ = static_cast<long>(getpid());
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        last_error_ = "Falha ao consultar historico " + path + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    if (size == 0) {
+        // Arquivo novo: reserva o primeiro bloco e escreve o cabecalho
+        if (ftruncate(fd_, kGrowStep) != 0 || !map_file(kGrowStep)) {
+            last_error_ = "Falha ao criar historico " + path + ": " + std::strerror(errno);
+            close();
+            return false;
+        }
+        std::memset(data_, 0, kHeaderSize);
+        std::memcpy(data_, kMagic, sizeof(kMagic));
+        uint64_t file_id = (static_cast<uint64_t>(std::random_device{}()) << 32) ^
+                           static_cast<uint64_t>(std::time(nullptr));
+        std::memcpy(data_ + kFileIdOffset, &file_id, sizeof(file_id));
+        set_used(kHeaderSize);
+        indexed_ = true;
+        return true;
+    }
+
+    if (size < kHeaderSize || !map_file(size) || std::memcmp(data_, kMagic, sizeof(kMagic)) != 0) {
+        last_error_ = "Arquivo de historico invalido: " + path;
+        close();
+        return false;
+    }
+
+    std::memcpy(&used_, data_ + kUsedOffset, sizeof(used_));
+    if (used_ < kHeaderSize || used_ > capacity_) {
+        last_error_ = "Cabecalho do historico corrompido: " + path;
+        close();
+        return false;
+    }
+
+    uint64_t start = load_checkpoint() ? checkpoint_offset_ : kHeaderSize;
+    rebuild_index(start);
+    indexed_ = true;
+    return true;
+}
+
+void PriceHistory::close() {
+    if (indexed_ && used_ != checkpoint_offset_) {
+        checkpoint();
+    }
+    if (data_) {
+        msync(data_, capacity_, MS_SYNC);
+        munmap(data_, capacity_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    capacity_ = 0;
+    used_ = 0;
+    indexed_ = false;
+    checkpoint_offset_ = 0;
+    products_.clear();
+    ids_.clear();
+}
+
+bool PriceHistory::sync() {
+    if (!data_) return false;
+    if (msync(data_, capacity_, MS_SYNC) != 0) {
+        last_error_ = "Falha ao sincronizar historico: " + std::string(std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool PriceHistory::map_file(uint64_t capacity) {
+    void* addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED) return false;
+    data_ = static_cast<uint8_t*>(addr);
+    capacity_ = capacity;
+    return true;
+}
+
+bool PriceHistory::ensure_capacity(uint64_t extra) {
+    if (used_ + extra <= capacity_) return true;
+
+    uint64_t new_capacity = std::max(capacity_ * 2, used_ + extra);
+    new_capacity = (new_capacity + kGrowStep - 1) / kGrowStep * kGrowStep;
+
+    if (ftruncate(fd_, static_cast<off_t>(new_capacity)) != 0) {
+        last_error_ = "Falha ao expandir historico: " + std::string(std::strerror(errno));
+        return false;
+    }
+    munmap(data_, capacity_);
+    data_ = nullptr;
+    if (!map_file(new_capacity)) {
+        last_error_ = "Falha ao remapear historico: " + std::string(std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void PriceHistory::set_used(uint64_t used) {
+    // O tamanho usado so e publicado no cabecalho depois que o registro foi
+    // escrito por completo; um registro parcial e descartado na reabertura
+    used_ = used;
+    std::memcpy(data_ + kUsedOffset, &used_, sizeof(used_));
+}
+
+// Carrega o indice salvo por checkpoint(). Qualquer inconsistencia com o log
+// atual (outro arquivo, log truncado, offsets fora do lugar) invalida o
+// checkpoint e o indice e reconstruido do zero.
+bool PriceHistory::load_checkpoint() {
+    std::ifstream file(path_ + ".idx", std::ios::binary);
+    if (!file.is_open()) return false;
+
+    char magic[sizeof(kIndexMagic)];
+    uint64_t file_id, covered, count, log_id;
+    std::memcpy(&log_id, data_ + kFileIdOffset, sizeof(log_id));
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+        !read_pod(file, file_id) || !read_pod(file, covered) || !read_pod(file, count) ||
+        file_id != log_id || covered < kHeaderSize || covered > used_ || count > covered) {
+        return false;
+    }
+
+    products_.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        uint32_t url_size;
+        ProductIndex product;
+        ProductStats& stats = product.stats;
+        bool ok = read_pod(file, url_size) && url_size > 0 && url_size <= kMaxUrlSize;
+        if (ok) {
+            stats.url.resize(url_size);
+            ok = static_cast<bool>(file.read(&stats.url[0], url_size)) &&
+                 read_pod(file, stats.min_price) && read_pod(file, stats.max_price) &&
+                 read_pod(file, stats.last_price) && read_pod(file, stats.last_timestamp) &&
+                 read_pod(file, stats.count) && read_pod(file, product.last_offset);
+        }
+        if (ok && stats.count > 0) {
+            ok = product.last_offset >= kHeaderSize && product.last_offset < covered &&
+                 data_[product.last_offset] == kObservationRecord;
+        }
+        if (!ok) {
+            products_.clear();
+            ids_.clear();
+            return false;
+        }
+        ids_[stats.url] = static_cast<uint32_t>(products_.size());
+        products_.push_back(std::move(product));
+    }
+
+    checkpoint_offset_ = covered;
+    return true;
+}
+
+bool PriceHistory::checkpoint() {
+    if (!data_ || !indexed_ || static_cast<long>(getpid()) != owner_pid_) return false;
+
+    // O log precisa estar em disco antes do indice que o referencia
+    if (!sync()) return false;
+
+    std::string tmp_path = path_ + ".idx.tmp";
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        last_error_ = "Falha ao criar checkpoint do historico: " + tmp_path;
+        return false;
+    }
+
+    uint64_t file_id;
+    std::memcpy(&file_id, data_ + kFileIdOffset, sizeof(file_id));
+    file.write(kIndexMagic, sizeof(kIndexMagic));
+    write_pod(file, file_id);
+    write_pod(file, used_);
+    write_pod(file, static_cast<uint64_t>(products_.size()));
+    for (const auto& product : products_) {
+        const ProductStats& stats = product.stats;
+        write_pod(file, static_cast<uint32_t>(stats.url.size()));
+        file.write(stats.url.data(), stats.url.size());
+        write_pod(file, stats.min_price);
+        write_pod(file, stats.max_price);
+        write_pod(file, stats.last_price);
+        write_pod(file, stats.last_timestamp);
+        write_pod(file, stats.count);
+        write_pod(file, product.last_offset);
+    }
+    file.close();
+
+    if (!file || std::rename(tmp_path.c_str(), (path_ + ".idx").c_str()) != 0) {
+        last_error_ = "Falha ao gravar checkpoint do historico: " + path_ + ".idx";
+        return false;
+    }
+    checkpoint_offset_ = used_;
+    return true;
+}
+
+// Reconstroi o indice em memoria lendo o log a partir de `start`
+bool PriceHistory::rebuild_index(uint64_t start) {
+    const uint8_t* end = data_ + used_;
+    uint64_t offset = start;
+
+    while (offset < used_) {
+        const uint8_t* p = data_ + offset;
+        size_t n = 0;
+
+        if (*p == kProductRecord) {
+            uint64_t len;
+            size_t hn = get_varint(p + 1, end, len);
+            if (hn && len <= static_cast<uint64_t>(end - (p + 1 + hn))) {
+                add_product(std::string(reinterpret_cast<const char*>(p + 1 + hn), len));
+                n = 1 + hn + len;
+            }
+        } else if (*p == kObservationRecord) {
+            uint64_t id, prev_distance;
+            int64_t dts, dprice;
+            size_t bn = get_observation(p + 1, end, id, prev_distance, dts, dprice);
+            if (bn && id < products_.size()) {
+                ProductIndex& product = products_[id];
+                ProductStats& stats = product.stats;
+                stats.last_timestamp += dts;
+                stats.last_price += dprice;
+                if (stats.count == 0 || stats.last_price < stats.min_price) stats.min_price = stats.last_price;
+                if (stats.count == 0 || stats.last_price > stats.max_price) stats.max_price = stats.last_price;
+                ++stats.count;
+                product.last_offset = offset;
+                n = 1 + bn;
+            }
+        }
+
+        if (n == 0) {
+            // Cauda corrompida: descarta a partir daqui e segue com o que foi lido
+            last_error_ = "Registro invalido no historico em offset " + std::to_string(offset) + ", descartando o restante";
+            set_used(offset);
+            break;
+        }
+        offset += n;
+    }
+    return true;
+}
+
+uint32_t PriceHistory::add_product(const std::string& url) {
+    uint32_t id = static_cast<uint32_t>(products_.size());
+    ProductIndex product;
+    product.stats.url = url;
+    products_.push_back(product);
+    ids_[url] = id;
+    return id;
+}
+
+bool PriceHistory::record(const std::string& url, int64_t timestamp, int64_t price_cents) {
+    if (!data_) {
+        last_error_ = "Historico nao esta aberto";
+        return false;
+    }
+    // Um filho de fork herda o mapeamento e a trava do pai; escrever dali
+    // corromperia o log da mesma forma que um segundo processo
+    if (static_cast<long>(getpid()) != owner_pid_) {
+        last_error_ = "Historico aberto em outro processo (fork); abra um arquivo proprio neste processo";
+        return false;
+    }
+
+    std::string key = canonical_url(url);
+    if (key.empty()) {
+        last_error_ = "URL vazia ou invalida: " + url;
+        return false;
+    }
+    // Mesmo limite do leitor de checkpoint: uma chave maior invalidaria todo
+    // checkpoint seguinte e cada open() voltaria a reler o log inteiro
+    if (key.size() > kMaxUrlSize) {
+        last_error_ = "URL maior que " + std::to_string(kMaxUrlSize) + " bytes: " + key.substr(0, 80) + "...";
+        return false;
+    }
+
+    uint32_t id;
+    auto it = ids_.find(key);
+    // Serie fora de ordem quebraria last_price/find_drops e a parada do walk_back
+    if (it != ids_.end() && timestamp < products_[it->second].stats.last_timestamp) {
+        last_error_ = "Observacao fora de ordem para " + key + ": " + std::to_string(timestamp) +
+                      " < " + std::to_string(products_[it->second].stats.last_timestamp);
+        return false;
+    }
+    if (it == ids_.end()) {
+        if (!ensure_capacity(1 + kMaxVarint + key.size())) return false;
+        uint8_t* p = data_ + used_;
+        p[0] = kProductRecord;
+        size_t n = 1 + put_varint(p + 1, key.size());
+        std::memcpy(p + n, key.data(), key.size());
+        set_used(used_ + n + key.size());
+        id = add_product(key);
+    } else {
+        id = it->second;
+    }
+
+    if (!ensure_capacity(1 + 4 * kMaxVarint)) return false;
+
+    ProductIndex& product = products_[id];
+    ProductStats& stats = product.stats;
+    uint64_t offset = used_;
+    uint64_t prev_distance = stats.count ? offset - product.last_offset : 0;
+
+    uint8_t* p = data_ + offset;
+    size_t n = 0;
+    p[n++] = kObservationRecord;
+    n += put_varint(p + n, id);
+    n += put_varint(p + n, prev_distance);
+    n += put_varint(p + n, zigzag(timestamp - stats.last_timestamp));
+    n += put_varint(p + n, zigzag(price_cents - stats.last_price));
+    set_used(offset + n);
+
+    if (stats.count == 0 || price_cents < stats.min_price) stats.min_price = price_cents;
+    if (stats.count == 0 || price_cents > stats.max_price) stats.max_price = price_cents;
+    stats.last_timestamp = timestamp;
+    stats.last_price = price_cents;
+    ++stats.count;
+    product.last_offset = offset;
+    return true;
+}
+
+// Percorre as observacoes de um produto da mais recente para a mais antiga,
+// seguindo a distancia gravada em cada registro. Para quando visit retorna false.
+template <typename Visitor>
+void PriceHistory::walk_back(const ProductIndex& product, Visitor&& visit) const {
+    if (product.stats.count == 0) return;
+
+    const uint8_t* end = data_ + used_;
+    uint64_t offset = product.last_offset;
+    Observation current{product.stats.last_timestamp, product.stats.last_price};
+
+    while (visit(current)) {
+        uint64_t id, prev_distance;
+        int64_t dts, dprice;
+        if (!get_observation(data_ + offset + 1, end, id, prev_distance, dts, dprice)) return;
+        if (prev_distance == 0 || prev_distance > offset) return;
+        current.timestamp -= dts;
+        current.price_cents -= dprice;
+        offset -= prev_distance;
+    }
+}
+
+bool PriceHistory::get_stats(const std::string& url, ProductStats& out) const {
+    auto it = ids_.find(canonical_url(url));
+    if (it == ids_.end()) return false;
+    out = products_[it->second].stats;
+    return true;
+}
+
+std::vector<PriceHistory::Observation> PriceHistory::get_series(const std::string& url) const {
+    std::vector<Observation> series;
+    auto it = ids_.find(canonical_url(url));
+    if (it == ids_.end()) return series;
+
+    const ProductIndex& product = products_[it->second];
+    series.reserve(product.stats.count);
+    walk_back(product, [&series](const Observation& obs) {
+        series.push_back(obs);
+        return true;
+    });
+    std::reverse(series.begin(), series.end());
+    return series;
+}
+
+std::vector<PriceHistory::PriceDrop> PriceHistory::find_drops(double min_percent, int64_t window_seconds, int64_t now) const {
+    std::vector<PriceDrop> drops;
+    int64_t since = now - window_seconds;
+
+    for (const auto& product : products_) {
+        const ProductStats& stats = product.stats;
+        // Sem observacao na janela, ou o maximo historico ja nao configura queda
+        if (stats.count == 0 || stats.last_timestamp < since || stats.last_timestamp > now) continue;
+        if (stats.max_price <= 0 || stats.max_price <= stats.last_price) continue;
+
+        // A ultima observacao ate `since` e o preco vigente no inicio da janela;
+        // com coleta diaria, costuma ser a unica referencia antes da amostra atual
+        int64_t peak = stats.last_price;
+        walk_back(product, [&peak, since](const Observation& obs) {
+            peak = std::max(peak, obs.price_cents);
+            return obs.timestamp > since;
+        });
+
+        if (peak <= 0 || peak <= stats.last_price) continue;
+        double percent = 100.0 * static_cast<double>(peak - stats.last_price) / static_cast<double>(peak);
+        if (percent >= min_percent) {
+            drops.push_back({stats.url, peak, stats.last_price, percent});
+        }
+    }
+
+    std::sort(drops.begin(), drops.end(), [](const PriceDrop& a, const PriceDrop& b) {
+        return a.percent > b.percent;
+    });
+    return drops;
+}
+
+// Chave estavel do produto:
+//  - Amazon: esquema/host + /dp/<ASIN> (tambem a partir de /gp/product/<ASIN>)
+//  - Mercado Livre: esquema/host + /MLB-<id> ou /p/MLB<id>
+//  - links patrocinados (/sspa/click?...&url=...) usam o destino do parametro url
+//  - links de clique/redirecionamento sem id de produto ficam inteiros, pois a
+//    query e a unica coisa que distingue um anuncio do outro
+//  - demais URLs: sem query string, fragmento e barra final
+std::string PriceHistory::canonical_url(const std::string& url) {
+    std::string result = url.substr(0, url.find('#'));
+    std::string origin, path, query;
+    split_url(result, origin, path, query);
+
+    std::string product = product_url(origin, path);
+    if (!product.empty()) return product;
+
+    std::string target = percent_decode(query_param(query, "url"));
+    if (!target.empty()) {
+        if (target[0] == '/') target = origin + target;
+        std::string target_origin, target_path, target_query;
+        split_url(target, target_origin, target_path, target_query);
+        product = product_url(target_origin, target_path);
+        if (!product.empty()) return product;
+    }
+
+    if (is_redirect_url(origin, path)) {
+        return origin + path + (query.empty() ? "" : "?" + query);
+    }
+
+    result = origin + path;
+    while (result.size() > origin.size() && result.back() == '/') {
+        result.pop_back();
+    }
+    return result;
+}
+
+// Converte precos no formato brasileiro ("R$ 1.299,90", "1.299") para centavos
+bool PriceHistory::parse_price_cents(const std::string& price, int64_t& cents) {
+    // 15 digitos de reais ja passam de qualquer preco real e cabem em int64 como centavos
+    const int kMaxIntegerDigits = 15;
+    int64_t reais = 0;
+    int64_t fraction = 0;
+    int integer_digits = 0;
+    int fraction_digits = 0;
+    bool after_comma = false;
+    bool has_digit = false;
+
+    for (char c : price) {
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            has_digit = true;
+            if (!after_comma) {
+                if (reais == 0 && c == '0') continue; // zeros a esquerda
+                if (++integer_digits > kMaxIntegerDigits) return false;
+                reais = reais * 10 + (c - '0');
+            } else if (fraction_digits < 2) {
+                fraction = fraction * 10 + (c - '0');
+                ++fraction_digits;
+            }
+        } else if (c == ',') {
+            if (after_comma) break;
+            after_comma = true;
+        } else if (c != '.' && has_digit && !std::isspace(static_cast<unsigned char>(c))) {
+            break;
+        }
+    }
+
+    if (!has_digit) return false;
+    if (fraction_digits == 1) fraction *= 10;
+    cents = reais * 100 + fraction;
+    return true;
+}
@@ -1,6 +1,7 @@
 #include "scraper.h"
 
 #include <algorithm>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
@@ -22,6 +23,11 @@ WebScraper::~WebScraper() {
     }
 }
 
+// Historico opcional; o WebScraper nao assume a posse do ponteiro
+void WebScraper::set_price_history(PriceHistory* history) {
+    price_history_ = history;
+}
+
 // Callback para armazenar o conteúdo da página baixada
 size_t WebScraper::write_callback(void* contents, size_t size, size_t nmemb, std::string* userp) {
     size_t realsize = size * nmemb;
@@ -339,6 +345,25 @@ void WebScraper::save_to_file(const std::vector<ScrapedItem>& items, const std::
     }
 }
 
+// Acrescenta os precos raspados ao historico, indexados pela URL canonica
+void WebScraper::record_prices(const std::vector<ScrapedItem>& items) {
+    if (!price_history_ || !price_history_->is_open()) return;
+
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    size_t recorded = 0;
+    for (const auto& item : items) {
+        int64_t cents;
+        if (item.url.empty() || item.url == "N/A" || !PriceHistory::parse_price_cents(item.price, cents)) continue;
+        if (price_history_->record(item.url, now, cents)) {
+            ++recorded;
+        } else {
+            logger.log(Logger::LogLevel::ERR, "Falha ao gravar historico: " + price_history_->last_error());
+            break;
+        }
+    }
+    price_history_->sync();
+    logger.log(Logger::LogLevel::INFO, std::to_string(recorded) + " precos gravados no historico.");
+}
 
 // Função principal de scraping
 bool WebScraper::scrape() {
@@ -362,6 +387,7 @@ bool WebScraper::scrape() {
             items = parse_amazon(output->root);
             save_to_file(items, "../output/amazon_data.txt");
         }
+        record_prices(items);
 
         if (items.empty()) {
           // logger.log(Logger::LogLevel::WARNING, "Nenhum item encontrado em: " + site.name);  // usar so pra teste
@@ -374,31 +400,35 @@ bool WebScraper::scrape() {
     return true;
 }
 
-bool WebScraper::scrape_um_site(const Config::SiteConfig& site, const std::string& searchTerm) {
-    if (!curl) {
-        logger.log(Logger::LogLevel::ERR, "CURL nao inicializado para raspagem de site unico.");
-        return false;
+// Monta a URL de busca de cada site para o termo informado, com o termo
+// codificado para URL (o Mercado Livre usa '-' no lugar dos espacos)
+std::string WebScraper::build_search_url(const Config::SiteConfig& site, const std::string& searchTerm) {
+    std::string formattedSearchTerm = searchTerm;
+    if (site.name == "Mercado Livre") {
+        std::replace(formattedSearchTerm.begin(), formattedSearchTerm.end(), ' ', '-');
     }
 
-    logger.log(Logger::LogLevel::INFO, "Iniciando raspagem em: " + site.name + " para o termo: '" + searchTerm + "'");
+    char* escaped = curl_easy_escape(curl, formattedSearchTerm.c_str(), static_cast<int>(formattedSearchTerm.size()));
+    if (escaped) {
+        formattedSearchTerm = escaped;
+        curl_free(escaped);
+    } else {
+        logger.log(Logger::LogLevel::WARNING, "Falha ao codificar termo de busca: " + searchTerm);
+    }
 
     std::string searchUrl = site.baseUrl;  // Base URL do site
     if (site.name == "Mercado Livre") {
-        std::string formattedSearchTerm = searchTerm;
-        std::replace(formattedSearchTerm.begin(), formattedSearchTerm.end(), ' ', '-');
         searchUrl += formattedSearchTerm;
     } else if (site.name == "OLX") {
-        searchUrl += "?q=" + searchTerm;
+        searchUrl += "?q=" + formattedSearchTerm;
     } else if (site.name == "Amazon") {
-        searchUrl += "?k=" + searchTerm;
-    }
-
-    std::string html = fetch_page(searchUrl, config.get_max_retries());
-    if (html.empty()) {
-        logger.log(Logger::LogLevel::ERR, "Falha ao obter HTML para " + site.name);
-        return false;
+        searchUrl += "?k=" + formattedSearchTerm;
     }
+    return searchUrl;
+}
 
+// Escolhe o parser do site e libera a arvore do Gumbo
+std::vector<WebScraper::ScrapedItem> WebScraper::parse_page(const Config::SiteConfig& site, const std::string& html) {
     GumboOutput* output = gumbo_parse(html.c_str());
     std::vector<ScrapedItem> items;
 
@@ -411,6 +441,27 @@ bool WebScraper::scrape_um_site(const Config::SiteConfig& site, const std::strin
     } else {
         logger.log(Logger::LogLevel::WARNING, "Parser nao implementado para o site: " + site.name);
     }
+
+    gumbo_destroy_output(&kGumboDefaultOptions, output);
+    return items;
+}
+
+bool WebScraper::scrape_um_site(const Config::SiteConfig& site, const std::string& searchTerm) {
+    if (!curl) {
+        logger.log(Logger::LogLevel::ERR, "CURL nao inicializado para raspagem de site unico.");
+        return false;
+    }
+
+    logger.log(Logger::LogLevel::INFO, "Iniciando raspagem em: " + site.name + " para o termo: '" + searchTerm + "'");
+
+    std::string searchUrl = build_search_url(site, searchTerm);
+    std::string html = fetch_page(searchUrl, config.get_max_retries());
+    if (html.empty()) {
+        logger.log(Logger::LogLevel::ERR, "Falha ao obter HTML para " + site.name);
+        return false;
+    }
+
+    std::vector<ScrapedItem> items = parse_page(site, html);
     std::string debug_filename = site.name + "_debug_page.html";
     logger.log(Logger::LogLevel::INFO, "SALVANDO HTML PARA DEPURACAO EM: " + debug_filename);
     std::ofstream html_file(debug_filename);
@@ -421,16 +472,69 @@ bool WebScraper::scrape_um_site(const Config::SiteConfig& site, const std::strin
         logger.log(Logger::LogLevel::ERR, "Falha ao criar arquivo de debug HTML.");
     }
 
-    gumbo_destroy_output(&kGumboDefaultOptions, output);
-
     std::string full_output_path = output_directory_ + "/" + site.output_file;
     save_to_file(items, full_output_path);
+    record_prices(items);
 
     logger.log(Logger::LogLevel::INFO, "Raspagem concluida para " + site.name);
     return true;
 }
 
 
+// Modo shard: raspa apenas os termos que pertencem a este shard, em todos os
+// sites, e grava um unico TSV particionado em shard_dir para o merge posterior.
+bool WebScraper::scrape_shard(const ShardSpec& spec, const std::vector<std::string>& terms, const std::string& shard_dir) {
+    if (!curl) {
+        logger.log(Logger::LogLevel::ERR, "CURL nao inicializado para raspagem do shard.");
+        return false;
+    }
+
+    if (terms.empty()) {
+        logger.log(Logger::LogLevel::ERR, "Lista de termos vazia para o shard.");
+        return false;
+    }
+
+    std::vector<std::string> owned = shard::select_terms(terms, spec);
+    logger.log(Logger::LogLevel::INFO, "Shard " + std::to_string(spec.index) + "/" + std::to_string(spec.count) +
+               ": " + std::to_string(owned.size()) + " de " + std::to_string(terms.size()) + " termos.");
+
+    ShardHeader header;
+    header.spec = spec;
+    header.terms_fingerprint = shard::terms_fingerprint(terms);
+
+    std::vector<ShardRecord> records;
+    for (const auto& term : owned) {
+        for (const auto& site : config.get_sites()) {
+            std::string html = fetch_page(build_search_url(site, term), config.get_max_retries());
+            if (html.empty()) {
+                // Fica registrado no cabecalho do shard para o merge reportar
+                logger.log(Logger::LogLevel::ERR, "Falha ao obter HTML para " + site.name + " termo '" + term + "'");
+                header.failed.push_back({site.name, term});
+                continue;
+            }
+
+            // O historico e gravado no merge, a partir do resultado deduplicado
+            int64_t fetched_at = static_cast<int64_t>(std::time(nullptr));
+            std::vector<ScrapedItem> items = parse_page(site, html);
+            for (const auto& item : items) {
+                records.push_back({site.name, term, item.title, item.price, item.url, fetched_at});
+            }
+        }
+    }
+
+    if (!shard::write_shard(shard_dir, header, records)) {
+        logger.log(Logger::LogLevel::ERR, "Falha ao gravar shard em: " + shard_dir);
+        return false;
+    }
+    logger.log(Logger::LogLevel::INFO, "Shard gravado: " + shard_dir + "/" + shard::shard_file_name(spec));
+
+    if (!header.failed.empty()) {
+        logger.log(Logger::LogLevel::ERR, std::to_string(header.failed.size()) + " buscas falharam neste shard.");
+        return false;
+    }
+    return true;
+}
+
 
 /* EM SALVAMENTO para baixar html e poder analisar o parser de cada site
 
@@ -0,0 +1,381 @@
+#include "shard.h"
+#include "price_history.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace shard {
+
+namespace {
+
+// Tabs e quebras de linha nos campos quebrariam o TSV
+std::string sanitize(const std::string& field) {
+    std::string result = field;
+    std::replace_if(result.begin(), result.end(),
+                    [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+    return result;
+}
+
+// Escreve em arquivo temporario e renomeia, para nunca expor um TSV pela metade
+bool write_tsv(const std::filesystem::path& path, const std::vector<std::string>& header_lines,
+               const std::vector<ShardRecord>& records) {
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+
+    std::ofstream file(tmp_path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) return false;
+    for (const auto& line : header_lines) {
+        file << line << '\n';
+    }
+    for (const auto& record : records) {
+        file << sanitize(record.site) << '\t' << sanitize(record.term) << '\t'
+             << sanitize(record.title) << '\t' << sanitize(record.price) << '\t'
+             << sanitize(record.url) << '\t' << record.timestamp << '\n';
+    }
+    file.close();
+    if (!file) return false;
+
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+std::string to_hex(uint64_t value) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+std::vector<std::string> split_tabs(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, '\t')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+// Linhas "#failed" compartilhadas pelos shards e pelo resultado do merge
+void append_failed(std::vector<std::string>& lines, const std::vector<FailedFetch>& failed) {
+    for (const auto& fetch : failed) {
+        lines.push_back("#failed\t" + sanitize(fetch.site) + "\t" + sanitize(fetch.term));
+    }
+}
+
+} // namespace
+
+std::string normalize_term(const std::string& term) {
+    std::string result;
+    bool pending_space = false;
+    for (char c : term) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pending_space = !result.empty();
+            continue;
+        }
+        if (pending_space) {
+            result += ' ';
+            pending_space = false;
+        }
+        result += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return result;
+}
+
+uint64_t stable_hash(const std::string& text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool owns_term(const std::string& term, const ShardSpec& spec) {
+    if (spec.count == 0) return false;
+    return stable_hash(normalize_term(term)) % spec.count == spec.index;
+}
+
+bool parse_spec(const std::string& text, ShardSpec& spec) {
+    size_t slash = text.find('/');
+    if (slash == std::string::npos) return false;
+    try {
+        size_t pos;
+        unsigned long index = std::stoul(text.substr(0, slash), &pos);
+        if (pos != slash) return false;
+        std::string count_text = text.substr(slash + 1);
+        unsigned long count = std::stoul(count_text, &pos);
+        if (pos != count_text.size() || count == 0 || index >= count) return false;
+        spec.index = index;
+        spec.count = count;
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool load_terms(const std::string& path, std::vector<std::string>& terms, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "Nao foi possivel abrir a lista de termos: " + path;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string term = normalize_term(line);
+        if (!term.empty() && term[0] != '#') {
+            terms.push_back(term);
+        }
+    }
+    if (file.bad()) {
+        error = "Erro ao ler a lista de termos: " + path;
+        return false;
+    }
+    if (terms.empty()) {
+        error = "Lista de termos vazia: " + path;
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> select_terms(const std::vector<std::string>& terms, const ShardSpec& spec) {
+    std::vector<std::string> selected;
+    std::set<std::string> seen;
+    for (const auto& raw : terms) {
+        std::string term = normalize_term(raw);
+        if (term.empty() || !owns_term(term, spec)) continue;
+        if (seen.insert(term).second) {
+            selected.push_back(term);
+        }
+    }
+    return selected;
+}
+
+uint64_t terms_fingerprint(const std::vector<std::string>& terms) {
+    std::set<std::string> unique;
+    for (const auto& term : terms) {
+        std::string normalized = normalize_term(term);
+        if (!normalized.empty()) unique.insert(normalized);
+    }
+    std::string joined;
+    for (const auto& term : unique) {
+        joined += term;
+        joined += '\n';
+    }
+    return stable_hash(joined);
+}
+
+std::string shard_file_name(const ShardSpec& spec) {
+    return "shard-" + std::to_string(spec.index) + "-of-" + std::to_string(spec.count) + ".tsv";
+}
+
+bool write_shard(const std::string& output_dir, const ShardHeader& header, const std::vector<ShardRecord>& records) {
+    try {
+        std::filesystem::create_directories(output_dir);
+    } catch (const std::filesystem::filesystem_error&) {
+        return false;
+    }
+
+    std::vector<std::string> lines = {
+        "#shard\t" + std::to_string(header.spec.index) + "\t" + std::to_string(header.spec.count),
+        "#terms\t" + to_hex(header.terms_fingerprint),
+    };
+    append_failed(lines, header.failed);
+    return write_tsv(std::filesystem::path(output_dir) / shard_file_name(header.spec), lines, records);
+}
+
+bool read_shard(const std::string& path, ShardHeader& header, std::vector<ShardRecord>& records) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    bool has_spec = false;
+    bool has_fingerprint = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        std::vector<std::string> fields = split_tabs(line);
+
+        if (line[0] == '#') {
+            try {
+                if (fields[0] == "#shard" && fields.size() == 3) {
+                    header.spec.index = std::stoul(fields[1]);
+                    header.spec.count = std::stoul(fields[2]);
+                    has_spec = true;
+                } else if (fields[0] == "#terms" && fields.size() == 2) {
+                    header.terms_fingerprint = std::stoull(fields[1], nullptr, 16);
+                    has_fingerprint = true;
+                } else if (fields[0] == "#failed" && fields.size() == 3) {
+                    header.failed.push_back({fields[1], fields[2]});
+                }
+            } catch (const std::exception&) {
+                return false;
+            }
+            continue;
+        }
+
+        fields.resize(6);
+        ShardRecord record{fields[0], fields[1], fields[2], fields[3], fields[4]};
+        try {
+            record.timestamp = fields[5].empty() ? 0 : std::stoll(fields[5]);
+        } catch (const std::exception&) {
+            return false;
+        }
+        records.push_back(std::move(record));
+    }
+    return has_spec && has_fingerprint && !file.bad();
+}
+
+bool merge_shards(const std::string& output_dir, const std::vector<std::string>& terms, size_t count,
+                  const std::string& merged_path, MergeResult& result, std::string& error,
+                  PriceHistory* history) {
+    uint64_t fingerprint = terms_fingerprint(terms);
+    std::vector<ShardRecord> records;
+    result = MergeResult();
+    error.clear();
+
+    for (size_t i = 0; i < count; ++i) {
+        ShardSpec spec{i, count};
+        std::string path = (std::filesystem::path(output_dir) / shard_file_name(spec)).string();
+        ShardHeader header;
+        if (!read_shard(path, header, records)) {
+            error = "Shard ausente, ilegivel ou sem cabecalho: " + path;
+            return false;
+        }
+        // Sobra de outra execucao ou worker com outra lista de termos
+        if (header.spec.index != i || header.spec.count != count || header.terms_fingerprint != fingerprint) {
+            error = "Shard de outra execucao (particionamento ou lista de termos diferente): " + path;
+            return false;
+        }
+        result.failed.insert(result.failed.end(), header.failed.begin(), header.failed.end());
+    }
+
+    std::sort(records.begin(), records.end(), [](const ShardRecord& a, const ShardRecord& b) {
+        if (a.site != b.site) return a.site < b.site;
+        if (a.term != b.term) return a.term < b.term;
+        if (a.title != b.title) return a.title < b.title;
+        return a.url < b.url;
+    });
+
+    // O mesmo anuncio pode aparecer em buscas diferentes; fica a primeira ocorrencia na ordem final.
+    // Links patrocinados sem id de produto mantem a URL inteira em canonical_url,
+    // entao anuncios distintos nao colapsam numa linha so.
+    std::set<std::pair<std::string, std::string>> seen;
+    std::vector<ShardRecord> merged;
+    merged.reserve(records.size());
+    for (auto& record : records) {
+        std::string key = record.url.empty() || record.url == "N/A"
+                              ? record.title
+                              : PriceHistory::canonical_url(record.url);
+        if (seen.insert({record.site, key}).second) {
+            merged.push_back(std::move(record));
+        }
+    }
+
+    std::filesystem::path merged_file(merged_path);
+    try {
+        if (merged_file.has_parent_path()) {
+            std::filesystem::create_directories(merged_file.parent_path());
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        error = "Erro de filesystem no merge: " + std::string(e.what());
+        return false;
+    }
+    std::vector<std::string> lines = {
+        "#merged\t" + std::to_string(count),
+        "#terms\t" + to_hex(fingerprint),
+    };
+    append_failed(lines, result.failed);
+    if (!write_tsv(merged_file, lines, merged)) {
+        error = "Falha ao escrever resultado do merge em: " + merged_path;
+        return false;
+    }
+
+    result.records = merged.size();
+
+    // Merge incompleto nao entra no historico: o passo seguinte e rodar de novo
+    // o shard que falhou e refazer o merge
+    if (history && result.failed.empty()) {
+        for (const auto& record : merged) {
+            int64_t cents;
+            if (record.url.empty() || record.url == "N/A" || !PriceHistory::parse_price_cents(record.price, cents)) continue;
+
+            // Idempotente: uma linha com coleta ate a ultima observacao do produto ja
+            // foi aplicada (merge repetido ou retomado) ou e de um diretorio mais antigo
+            PriceHistory::ProductStats stats;
+            if (history->get_stats(record.url, stats) && record.timestamp <= stats.last_timestamp) {
+                ++result.history_skipped;
+                continue;
+            }
+            if (!history->record(record.url, record.timestamp, cents)) {
+                error = "Falha ao gravar historico no merge: " + history->last_error();
+                return false;
+            }
+        }
+        history->sync();
+    }
+
+    if (!result.failed.empty()) {
+        error = std::to_string(result.failed.size()) + " buscas falharam nos workers; resultado incompleto em: " + merged_path;
+        return false;
+    }
+    return true;
+}
+
+bool run_local_workers(size_t count, const std::function<bool(const ShardSpec&)>& worker,
+                       const std::function<void()>& flush_output) {
+    // Sem esvaziar os buffers antes do fork, o texto pendente sairia uma vez por filho
+    auto flush_all = [&flush_output]() {
+        if (flush_output) flush_output();
+        std::cout.flush();
+        std::cerr.flush();
+        std::clog.flush();
+        std::fflush(nullptr);
+    };
+
+    std::vector<pid_t> children;
+    bool ok = true;
+
+    for (size_t i = 0; i < count; ++i) {
+        flush_all();
+        pid_t pid = fork();
+        if (pid < 0) {
+            ok = false;
+            break;
+        }
+        if (pid == 0) {
+            // O filho nunca pode voltar para o codigo do chamador: qualquer
+            // excecao vira falha do worker, e _exit nao esvazia buffers sozinho
+            int status = 1;
+            try {
+                ShardSpec spec{i, count};
+                status = worker(spec) ? 0 : 1;
+            } catch (...) {
+                status = 1;
+            }
+            try {
+                flush_all();
+            } catch (...) {
+                status = 1;
+            }
+            _exit(status);
+        }
+        children.push_back(pid);
+    }
+
+    for (pid_t pid : children) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // namespace shard